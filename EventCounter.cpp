@@ -12,9 +12,37 @@
 #include <fstream>
 #include <sstream>
 #include <stack>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
 using namespace std;
 #define RED 'R'
 #define BLACK 'B'
+// Number of buffered increase commands handed to the ingest workers at once
+#define INGEST_BATCH 65536
+// Number of pending private nodes after which the ingest workers are merged
+#define INGEST_MERGE_NODES (1 << 20)
+// Cost of one level of an insert relative to rebuilding one node of the tree
+#define INGEST_REBUILD_FACTOR 0.1
+// Number of records each ring between the pipeline stages can hold, a power of two
+#define PIPELINE_RING 4096
+// Number of records a pipeline stage moves through a ring at once
+#define PIPELINE_BATCH 256
+// Number of times a waiting pipeline stage yields before it starts sleeping
+#define PIPELINE_SPINS 64
+// Longest sleep in microseconds of a waiting pipeline stage
+#define PIPELINE_MAX_SLEEP 1000
+// Operation codes of the parsed command records
+#define CMD_QUIT 'q'
+#define CMD_INCREASE 'i'
+#define CMD_REDUCE 'r'
+#define CMD_COUNT 'c'
+#define CMD_INRANGE 'g'
+#define CMD_NEXT 'n'
+#define CMD_PREVIOUS 'p'
 
 #ifdef LINUX
 double timerval() {
@@ -38,6 +66,7 @@ class EventCounter
 {
 private:
     node* root;
+    int nodes;
     //Method to compare two ids
     int compare(int left, int right)
     {
@@ -105,15 +134,19 @@ private:
     void insertFixup(node* n);
     void deleteFixup(node* n);
     void verifyProperties(node*);
+    void destroy(node* cur);
 public:
     //Constructor to initialize the Event Counter from sorted IDs 
-    EventCounter(vector<pair<int, int> > &idCountPairs) {
-        int currentIndex = 0;
-        root = buildFromSorted(0, 0, (int)(idCountPairs.size()) - 1,
-            computeRedLevel((int)idCountPairs.size()), idCountPairs, currentIndex);
+    EventCounter(vector<pair<int, int> > &idCountPairs) : root(NULL), nodes(0) {
+        rebuild(idCountPairs);
     }
 
-    EventCounter() {}
+    EventCounter() : root(NULL), nodes(0) {}
+    ~EventCounter() { clear(); }
+    int size() { return nodes; }
+    void rebuild(vector<pair<int, int> > &idCountPairs);
+    void toSorted(vector<pair<int, int> > &idCountPairs);
+    void clear();
     int insert(int, int);
     void remove(int);
     node* search(int);
@@ -123,6 +156,53 @@ public:
 
 };
 
+//Replace the whole tree by a tree constructed from sorted IDs
+void EventCounter::rebuild(vector<pair<int, int> > &idCountPairs)
+{
+    clear();
+    int currentIndex = 0;
+    root = buildFromSorted(0, 0, (int)(idCountPairs.size()) - 1,
+        computeRedLevel((int)idCountPairs.size()), idCountPairs, currentIndex);
+    nodes = (int)idCountPairs.size();
+}
+
+//Append all the ID and count pairs of the tree in increasing ID order
+void EventCounter::toSorted(vector<pair<int, int> > &idCountPairs)
+{
+    stack<node*> path;
+    node* cur = root;
+    while (cur != NULL || !path.empty())
+    {
+        //Walk down to the leftmost node remembering the path
+        while (cur != NULL)
+        {
+            path.push(cur);
+            cur = cur->left;
+        }
+        cur = path.top();
+        path.pop();
+        idCountPairs.push_back(make_pair(cur->id, cur->count));
+        cur = cur->right;
+    }
+}
+
+//Delete all the nodes of the tree
+void EventCounter::clear()
+{
+    destroy(root);
+    root = NULL;
+    nodes = 0;
+}
+
+//Delete the subtree rooted at the node
+void EventCounter::destroy(node* cur)
+{
+    if (cur == NULL) return;
+    destroy(cur->left);
+    destroy(cur->right);
+    delete cur;
+}
+
 //Return Grandparent of Node
 node* EventCounter::grandparent(node* n)
 {
@@ -268,7 +348,8 @@ int EventCounter::insert(int id, int count)
         {
             int compResult = compare(id, n->id);
             if (compResult == 0)
-            {//update the count vlaue of the node
+            {//update the count vlaue of the node, the new node is not needed
+                delete insertedNode;
                 n->count += count;
                 return n->count;
             }
@@ -295,6 +376,7 @@ int EventCounter::insert(int id, int count)
         }
         insertedNode->parent = n;
     }
+    nodes++;
    //called to satisfy the properties of Red black tree to be balanced binary searchtree
     insertFixup(insertedNode);
     verifyProperties(root);
@@ -382,6 +464,7 @@ void EventCounter::remove(int id)
 	//Replace and delete the node.
     replaceNode(n, child);
     delete n;
+    nodes--;
     verifyProperties(root);
 }
 
@@ -389,8 +472,8 @@ void EventCounter::remove(int id)
 node* EventCounter::maxNode(node* cur)
 {
     if (cur == NULL) return NULL;
-    if (cur != NULL)
-        maxNode(cur->right);
+    if (cur->right != NULL)
+        return maxNode(cur->right);
     return cur;
 }
 
@@ -562,6 +645,539 @@ long long int EventCounter::inrange(int k1, int k2)
     return sum;
 }
 
+//Ingest of increase commands spread over worker threads with private trees.
+//Each worker owns the IDs which hash to it and accumulates their increases in
+//its own EventCounter, reading the shared tree only for the base count, so the
+//printed counts stay exact. The private trees are merged into the shared tree
+//periodically and before any other command is executed. Worker 0 is the calling
+//thread, the others are started once and wait for tasks between batches.
+//Increases are answered a batch at a time, when the batch is full or the input
+//has nothing more buffered, so this mode is meant for bulk input rather than
+//interactive use.
+class ParallelIngest
+{
+private:
+    EventCounter* global;
+    int workers;
+    vector<EventCounter*> local;
+    vector<pair<int, int> > batch;
+    vector<int> results;
+    vector<vector<int> > owned;
+    vector<vector<pair<int, int> > > runs;
+    vector<thread> pool;
+    mutex lock;
+    condition_variable wake;
+    condition_variable done;
+    void (ParallelIngest::*task)(int);
+    int generation;
+    int busy;
+    bool stopping;
+    //Fibonacci hash of the ID scaled into [0, workers) by its high bits
+    int owner(int id) { return (int)(((unsigned long long)((unsigned int)id * 0x9E3779B1u) * workers) >> 32); }
+    void serve(int w);
+    void runAll(void (ParallelIngest::*t)(int));
+    void work(int w);
+    void extract(int w);
+    void merge();
+public:
+    ParallelIngest(EventCounter* rbt, int n);
+    ~ParallelIngest();
+    void add(int id, int count, ostream &out);
+    void flush(ostream &out);
+    void sync(ostream &out);
+};
+
+ParallelIngest::ParallelIngest(EventCounter* rbt, int n)
+    : global(rbt), workers(n < 1 ? 1 : n), local(workers), owned(workers), runs(workers),
+      task(NULL), generation(0), busy(0), stopping(false)
+{
+    for (int w = 0; w < workers; w++)
+        local[w] = new EventCounter();
+    batch.reserve(INGEST_BATCH);
+    results.reserve(INGEST_BATCH);
+    for (int w = 1; w < workers; w++)
+        pool.push_back(thread(&ParallelIngest::serve, this, w));
+}
+
+ParallelIngest::~ParallelIngest()
+{
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (int w = 0; w < (int)pool.size(); w++)
+        pool[w].join();
+    for (int w = 0; w < workers; w++)
+        delete local[w];
+}
+
+//Loop of a pooled worker, running each new task once until stopped
+void ParallelIngest::serve(int w)
+{
+    int seen = 0;
+    unique_lock<mutex> guard(lock);
+    while (1)
+    {
+        while (!stopping && generation == seen)
+            wake.wait(guard);
+        if (stopping)
+            return;
+        seen = generation;
+        void (ParallelIngest::*t)(int) = task;
+        guard.unlock();
+        (this->*t)(w);
+        guard.lock();
+        if (--busy == 0)
+            done.notify_one();
+    }
+}
+
+//Run a task on every worker and wait until all of them have finished it
+void ParallelIngest::runAll(void (ParallelIngest::*t)(int))
+{
+    if (!pool.empty())
+    {
+        lock_guard<mutex> guard(lock);
+        task = t;
+        busy = (int)pool.size();
+        generation++;
+    }
+    wake.notify_all();
+    (this->*t)(0);
+    if (!pool.empty())
+    {
+        unique_lock<mutex> guard(lock);
+        while (busy > 0)
+            done.wait(guard);
+    }
+}
+
+//Buffer an increase command, the batch is handed to the workers when full
+void ParallelIngest::add(int id, int count, ostream &out)
+{
+    batch.push_back(make_pair(id, count));
+    if ((int)batch.size() == INGEST_BATCH)
+        flush(out);
+}
+
+//Apply the increases of the batch owned by one worker to its private tree
+void ParallelIngest::work(int w)
+{
+    for (int j = 0; j < (int)owned[w].size(); j++)
+    {
+        int i = owned[w][j];
+        int id = batch[i].first;
+        //The shared tree is only read while the workers run
+        node* n = global->search(id);
+        int base = (n == NULL ? 0 : n->count);
+        results[i] = base + local[w]->insert(id, batch[i].second);
+    }
+}
+
+//Run the workers over the buffered batch and print its results in order
+void ParallelIngest::flush(ostream &out)
+{
+    if (batch.empty())
+        return;
+    results.resize(batch.size());
+    //Hand every worker the positions of the increases it owns
+    for (int w = 0; w < workers; w++)
+        owned[w].clear();
+    for (int i = 0; i < (int)batch.size(); i++)
+        owned[owner(batch[i].first)].push_back(i);
+    runAll(&ParallelIngest::work);
+    for (int i = 0; i < (int)results.size(); i++)
+        out << results[i] << "\n";
+    batch.clear();
+    results.clear();
+
+    //Periodic merge once the private trees have grown large
+    int pending = 0;
+    for (int w = 0; w < workers; w++)
+        pending += local[w]->size();
+    if (pending >= INGEST_MERGE_NODES)
+        merge();
+}
+
+//Turn the private tree of a worker into a sorted run and empty it
+void ParallelIngest::extract(int w)
+{
+    runs[w].clear();
+    local[w]->toSorted(runs[w]);
+    local[w]->clear();
+}
+
+//K-way merge the sorted runs of the workers and fold them into the shared tree
+void ParallelIngest::merge()
+{
+    int pending = 0;
+    for (int w = 0; w < workers; w++)
+        pending += local[w]->size();
+    if (pending == 0)
+        return;
+    runAll(&ParallelIngest::extract);
+
+    //Min heap of the head ID of every run with the run it came from
+    priority_queue<pair<int, int>, vector<pair<int, int> >, greater<pair<int, int> > > heads;
+    vector<int> position(workers, 0);
+    for (int w = 0; w < workers; w++)
+        if (!runs[w].empty())
+            heads.push(make_pair(runs[w][0].first, w));
+    vector<pair<int, int> > deltas;
+    while (!heads.empty())
+    {
+        int w = heads.top().second;
+        heads.pop();
+        pair<int, int> &cur = runs[w][position[w]++];
+        //Runs are disjoint by owner but equal IDs are summed all the same
+        if (!deltas.empty() && deltas.back().first == cur.first)
+            deltas.back().second += cur.second;
+        else
+            deltas.push_back(cur);
+        if (position[w] < (int)runs[w].size())
+            heads.push(make_pair(runs[w][position[w]].first, w));
+    }
+    //Release the runs so they do not sit alongside the copies of the tree below
+    for (int w = 0; w < workers; w++)
+        vector<pair<int, int> >().swap(runs[w]);
+    if (deltas.empty())
+        return;
+
+    //Inserting costs about log(n) per delta, rebuilding is linear in the sizes
+    double n = global->size();
+    double d = deltas.size();
+    if (INGEST_REBUILD_FACTOR * d * log2(n + 2) < n + d)
+    {
+        for (int i = 0; i < (int)deltas.size(); i++)
+            global->insert(deltas[i].first, deltas[i].second);
+        return;
+    }
+    vector<pair<int, int> > current;
+    current.reserve(global->size());
+    global->toSorted(current);
+    vector<pair<int, int> > merged;
+    merged.reserve(current.size() + deltas.size());
+    int i = 0, j = 0;
+    while (i < (int)current.size() || j < (int)deltas.size())
+    {
+        if (j == (int)deltas.size() || (i < (int)current.size() && current[i].first < deltas[j].first))
+            merged.push_back(current[i++]);
+        else if (i == (int)current.size() || deltas[j].first < current[i].first)
+            merged.push_back(deltas[j++]);
+        else
+        {
+            merged.push_back(make_pair(current[i].first, current[i].second + deltas[j].second));
+            i++;
+            j++;
+        }
+    }
+    vector<pair<int, int> >().swap(current);
+    vector<pair<int, int> >().swap(deltas);
+    global->rebuild(merged);
+}
+
+//Bring the shared tree up to date so that queries see every increase
+void ParallelIngest::sync(ostream &out)
+{
+    flush(out);
+    merge();
+}
+
+//Compact binary form of one input command
+struct commandRecord
+{
+    char op;
+    int id;
+    int arg;
+};
+
+//Compact binary form of the answer to one command
+struct resultRecord
+{
+    char op;
+    int id;
+    long long int value;
+};
+
+//Read lines until a command is found, returns false on quit or end of input
+bool readCommand(istream &in, commandRecord &c)
+{
+    string command;
+    while (getline(in, command))
+    {
+        if (command.find("quit") == 0)
+            return false;
+        //command and arguments of the command soearated, lines without arguments are skipped
+        size_t space = command.find(' ');
+        if (space == string::npos)
+            continue;
+        string cmd = command.substr(0, space);
+        stringstream line(command.substr(space));
+        c.id = 0;
+        c.arg = 0;
+        if (cmd.compare("increase") == 0)
+            c.op = CMD_INCREASE;
+        else if (cmd.compare("reduce") == 0)
+            c.op = CMD_REDUCE;
+        else if (cmd.compare("count") == 0)
+            c.op = CMD_COUNT;
+        else if (cmd.compare("inrange") == 0)
+            c.op = CMD_INRANGE;
+        else if (cmd.compare("next") == 0)
+            c.op = CMD_NEXT;
+        else if (cmd.compare("previous") == 0)
+            c.op = CMD_PREVIOUS;
+        else
+            continue;
+        line >> c.id;
+        if (c.op == CMD_INCREASE || c.op == CMD_REDUCE || c.op == CMD_INRANGE)
+            line >> c.arg;
+        return true;
+    }
+    return false;
+}
+
+//Apply one command to the tree and record its answer
+void executeCommand(EventCounter* rbt, const commandRecord &c, resultRecord &r)
+{
+    r.op = c.op;
+    r.id = 0;
+    r.value = 0;
+    if (c.op == CMD_INCREASE)
+    {
+        //insert function will update the node when found else insert
+        r.value = rbt->insert(c.id, c.arg);
+    }
+    else if (c.op == CMD_REDUCE)
+    {
+        //search the tree if node found then decrement the value.
+        // Which if happens to make count less than or equal to zero.
+        //Thus deleting the node wanted to reduce.
+        node* n = rbt->search(c.id);
+        if (n != NULL)
+        {
+            n->count = n->count - c.arg;
+            if (n->count <= 0)
+                rbt->remove(c.id);
+            else
+                r.value = n->count;
+        }
+    }
+    else if (c.op == CMD_COUNT)
+    {
+        node* n1 = rbt->search(c.id);
+        r.value = (n1 == NULL ? 0 : n1->count);
+    }
+    else if (c.op == CMD_INRANGE)
+    {
+        //Take the ID1 and ID2 and find the summation of all the nodes between them
+        r.value = rbt->inrange(c.id, c.arg);
+    }
+    else if (c.op == CMD_NEXT || c.op == CMD_PREVIOUS)
+    {
+        // Get the next higher or the just lower ID node from the tree
+        node* n = (c.op == CMD_NEXT ? rbt->next(c.id) : rbt->previous(c.id));
+        if (n != NULL)
+        {
+            r.id = n->id;
+            r.value = n->count;
+        }
+    }
+}
+
+//Print the answer to one command
+void formatResult(const resultRecord &r, ostream &out)
+{
+    if (r.op == CMD_NEXT || r.op == CMD_PREVIOUS)
+        out << r.id << ' ' << r.value << '\n';
+    else
+        out << r.value << '\n';
+}
+
+//Bounded lock-free ring between exactly one producer and one consumer thread
+template <class T>
+class SpscRing
+{
+private:
+    vector<T> items;
+    size_t mask;
+    //Next position to read, only written by the consumer
+    alignas(64) atomic<size_t> head;
+    //Next position to write, only written by the producer
+    alignas(64) atomic<size_t> tail;
+public:
+    SpscRing(size_t capacity) : items(capacity), mask(capacity - 1), head(0), tail(0) {}
+    int push(const T* batch, int n);
+    int pop(T* batch, int n);
+    void pushAll(const T* batch, int n);
+    int popSome(T* batch, int n);
+    static void backoff(int &waits);
+    bool empty() { return head.load(memory_order_acquire) == tail.load(memory_order_acquire); }
+};
+
+//Copy as many records as fit into the ring, returns the number copied
+template <class T>
+int SpscRing<T>::push(const T* batch, int n)
+{
+    size_t t = tail.load(memory_order_relaxed);
+    size_t h = head.load(memory_order_acquire);
+    int k = (int)min((size_t)n, items.size() - (t - h));
+    for (int i = 0; i < k; i++)
+        items[(t + i) & mask] = batch[i];
+    tail.store(t + k, memory_order_release);
+    return k;
+}
+
+//Copy up to n records out of the ring, returns the number copied
+template <class T>
+int SpscRing<T>::pop(T* batch, int n)
+{
+    size_t h = head.load(memory_order_relaxed);
+    size_t t = tail.load(memory_order_acquire);
+    int k = (int)min((size_t)n, t - h);
+    for (int i = 0; i < k; i++)
+        batch[i] = items[(h + i) & mask];
+    head.store(h + k, memory_order_release);
+    return k;
+}
+
+//Wait a little longer each time, yielding first and then sleeping so that
+//an idle stage does not keep a core busy
+template <class T>
+void SpscRing<T>::backoff(int &waits)
+{
+    waits++;
+    if (waits <= PIPELINE_SPINS)
+    {
+        this_thread::yield();
+        return;
+    }
+    int shift = min(waits - PIPELINE_SPINS, 10);
+    this_thread::sleep_for(chrono::microseconds(min(1 << shift, PIPELINE_MAX_SLEEP)));
+}
+
+//Push all the records, waiting while the ring is full
+template <class T>
+void SpscRing<T>::pushAll(const T* batch, int n)
+{
+    int waits = 0;
+    while (n > 0)
+    {
+        int k = push(batch, n);
+        batch += k;
+        n -= k;
+        if (k == 0)
+            backoff(waits);
+        else
+            waits = 0;
+    }
+}
+
+//Pop at least one record, waiting while the ring is empty
+template <class T>
+int SpscRing<T>::popSome(T* batch, int n)
+{
+    int k;
+    int waits = 0;
+    while ((k = pop(batch, n)) == 0)
+        backoff(waits);
+    return k;
+}
+
+//Three stage pipeline: a parser thread turns input lines into command records,
+//an executor thread applies them to the tree in order and the calling thread
+//prints the result records. A quit record flows through all the stages last.
+class Pipeline
+{
+private:
+    EventCounter* rbt;
+    istream &in;
+    ostream &out;
+    SpscRing<commandRecord> commands;
+    SpscRing<resultRecord> results;
+    void parse();
+    void execute();
+    void format();
+public:
+    Pipeline(EventCounter* tree, istream &input, ostream &output)
+        : rbt(tree), in(input), out(output), commands(PIPELINE_RING), results(PIPELINE_RING) {}
+    void run();
+};
+
+//Parser stage, a partial batch is sent when no more input is buffered
+void Pipeline::parse()
+{
+    commandRecord batch[PIPELINE_BATCH];
+    int n = 0;
+    while (readCommand(in, batch[n]))
+    {
+        n++;
+        if (n == PIPELINE_BATCH || in.rdbuf()->in_avail() <= 0)
+        {
+            commands.pushAll(batch, n);
+            n = 0;
+        }
+    }
+    batch[n].op = CMD_QUIT;
+    commands.pushAll(batch, n + 1);
+}
+
+//Executor stage, the only thread touching the tree while the pipeline runs
+void Pipeline::execute()
+{
+    commandRecord batch[PIPELINE_BATCH];
+    resultRecord done[PIPELINE_BATCH];
+    while (1)
+    {
+        int n = commands.popSome(batch, PIPELINE_BATCH);
+        for (int i = 0; i < n; i++)
+        {
+            done[i].op = CMD_QUIT;
+            if (batch[i].op != CMD_QUIT)
+                executeCommand(rbt, batch[i], done[i]);
+        }
+        results.pushAll(done, n);
+        if (batch[n - 1].op == CMD_QUIT)
+            return;
+    }
+}
+
+//Formatter stage, output is flushed whenever it catches up with the executor
+void Pipeline::format()
+{
+    resultRecord batch[PIPELINE_BATCH];
+    while (1)
+    {
+        int n = results.popSome(batch, PIPELINE_BATCH);
+        for (int i = 0; i < n; i++)
+        {
+            if (batch[i].op == CMD_QUIT)
+            {
+                out.flush();
+                return;
+            }
+            formatResult(batch[i], out);
+        }
+        if (results.empty())
+            out.flush();
+    }
+}
+
+void Pipeline::run()
+{
+    //Standard streams are buffered by C++ only so the parser can see pending input
+    ios::sync_with_stdio(false);
+    //A tied input stream flushes the output before every read, which would
+    //touch the output from the parser thread while the formatter writes it
+    ostream* tied = in.tie(NULL);
+    thread parser(&Pipeline::parse, this);
+    thread executor(&Pipeline::execute, this);
+    format();
+    parser.join();
+    executor.join();
+    in.tie(tied);
+}
 
 int main(int argc, char *argv[])
 {
@@ -595,94 +1211,70 @@ int main(int argc, char *argv[])
     //Vectors created to store the file inputs initially freed
     idCountPairs.erase(idCountPairs.begin(), idCountPairs.end());
     idCountPairs.clear();
-    string command;
-    //command inputs
-    while (1)
+    //Optional modes: bbst file -ingest <threads> or bbst file -pipeline
+    ParallelIngest *ingest = NULL;
+    int ingestThreads = 0;
+    bool pipeline = false;
+    for (int i = 2; i < argc; i++)
     {
-        string cmd;
-        string arg;
-        getline(cin, command);
-		//program exits if quit command given
-        if (command.find("quit") == 0)
-            break;
-		//command and arguments of the command soearated.
-        cmd = command.substr(0, command.find(' '));
-        arg = command.substr(command.find(' '), command.length() - command.find(' '));
-
-        stringstream line(arg);
-        if (cmd.compare("increase") == 0)
-        {
-            int id, m;
-            line >> id >> m;
-			//insert function will update the node when found else insert
-            cout << rbt->insert(id, m) << endl;
-        }
-        else if (cmd.compare("reduce") == 0)
+        if (strcmp(argv[i], "-ingest") == 0 && i + 1 < argc)
+            ingestThreads = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "-pipeline") == 0)
+            pipeline = true;
+    }
+    if (pipeline && ingestThreads > 0)
+    {
+        cerr << "-ingest and -pipeline cannot be combined\n";
+        return 1;
+    }
+    if (pipeline)
+    {
+        //Parsing, executing and printing run on their own threads
+        Pipeline stages(rbt, cin, cout);
+        stages.run();
+    }
+    else
+    {
+        if (ingestThreads > 0)
+            ingest = new ParallelIngest(rbt, ingestThreads);
+        commandRecord c;
+        resultRecord r;
+        //Standard streams are buffered by C++ only so the ingest can see pending input
+        if (ingest != NULL)
+            ios::sync_with_stdio(false);
+        //command inputs, the program exits if quit command given
+        while (readCommand(cin, c))
         {
-			//search the tree if node found then decrement the value.
-			// Which if happens to make count less than or equal to zero.
-			//Thus deleting the node wanted to reduce.
-            int id, m;
-            line >> id >> m;
-            node* n = rbt->search(id);
-            if (n != NULL)
+            //insert function will update the node when found else insert
+            if (ingest != NULL && c.op == CMD_INCREASE)
             {
-                n->count = n->count - m;
-                if (n->count <= 0) {
-                    rbt->remove(id);
-                    cout << "0\n";
-                }
-                else {
-                    cout << n->count << "\n";
+                ingest->add(c.id, c.arg, cout);
+                //a partial batch is answered when no more input is buffered
+                if (cin.rdbuf()->in_avail() <= 0)
+                {
+                    ingest->flush(cout);
+                    cout.flush();
                 }
+                continue;
             }
-            else
-            {
-                cout << "0\n";
-            }
-
+            //queries wait for the ingest workers to be merged so they stay exact
+            if (ingest != NULL)
+                ingest->sync(cout);
+            executeCommand(rbt, c, r);
+            formatResult(r, cout);
+            if (r.op == CMD_INCREASE)
+                cout.flush();
         }
-        else if (cmd.compare("count") == 0)
+        if (ingest != NULL)
         {
-            int id;
-            line >> id;
-            node* n1 = rbt->search(id);
-			// print the count value of the searched ID
-            cout << (n1 == NULL ? 0 : n1->count) << "\n";
-        }
-        else if (cmd.compare("inrange") == 0)
-        {
-            int id1, id2;
-            line >> id1 >> id2;
-			//Take the ID1 and ID2 and find the summation of all the nodes between them
-            cout << rbt->inrange(id1, id2) << "\n";
-        }
-        else if (cmd.compare("next") == 0)
-        {
-            int id, m;
-            line >> id;
-			// Get the next higher ID node from the tree
-            node* next = rbt->next(id);
-            if (next != NULL)
-                cout << next->id << ' ' << next->count << '\n';
-            else
-                cout << "0 0\n";
-        }
-        else if (cmd.compare("previous") == 0)
-        {
-            int id, m;
-            line >> id;
-			// Get the just lower ID node from the tree
-            node* previous = rbt->previous(id);
-            if (previous != NULL)
-                cout << previous->id << ' ' << previous->count << '\n';
-            else
-                cout << "0 0\n";
+            ingest->sync(cout);
+            cout.flush();
         }
     }
 #ifdef LINUX
 	endTime = timerval();
 	printf(" \nElapsed time in seconds: %.8f\n",(endTime - startTime));
 #endif
+    delete ingest;
     return 0;
 }